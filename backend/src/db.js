@@ -70,6 +70,8 @@ CREATE TABLE IF NOT EXISTS alerts (
   desc TEXT,
   payload_ref TEXT,
   host TEXT,
+  iface TEXT,
+  sample_rate REAL,
   created_at DATETIME DEFAULT CURRENT_TIMESTAMP,
   FOREIGN KEY(rule_id) REFERENCES rules(id) ON DELETE SET NULL
 );
@@ -106,6 +108,14 @@ CREATE INDEX IF NOT EXISTS idx_audit_ts ON audit_logs(ts DESC);
 CREATE INDEX IF NOT EXISTS idx_rules_updated_at ON rules(updated_at DESC);
 `);
 
+// Alert columns added after the first release: add them to older databases
+const alertColumns = db.prepare('PRAGMA table_info(alerts);').all().map((col) => col.name);
+for (const [name, type] of [['host', 'TEXT'], ['iface', 'TEXT'], ['sample_rate', 'REAL']]) {
+  if (!alertColumns.includes(name)) {
+    db.exec(`ALTER TABLE alerts ADD COLUMN ${name} ${type};`);
+  }
+}
+
 // Seed admin user if env vars provided
 const ADMIN_USERNAME = process.env.ADMIN_USERNAME;
 const ADMIN_EMAIL = process.env.ADMIN_EMAIL;
@@ -14,7 +14,9 @@ app.use(bodyParser.json({ limit: "1mb" }));
 // --- CONFIGURATION ---
 // Set the device ID determined in our previous analysis (5 for Qualcomm Wi-Fi)
 // This should ideally come from .env, but since it's missing, we define it here.
+// Several interfaces can be captured at once: SENSOR_DEVICE_ID="5,7"
 const SENSOR_DEVICE_ID = process.env.SENSOR_DEVICE_ID || '5'; 
+const SENSOR_ARGS = SENSOR_DEVICE_ID.split(/[\s,]+/).filter(Boolean);
 
 // ALERT FUNCTION (Unchanged - already robust)
 /**
@@ -32,8 +34,8 @@ function ingestAlert(alert) {
 
   // Database Insert
     const stmt = db.prepare(
-    `INSERT INTO alerts (ts, src_ip, dst_ip, proto, rule, rule_id, severity, desc, payload_ref, host)
-      VALUES (COALESCE(@ts, CURRENT_TIMESTAMP), @src_ip, @dst_ip, @proto, @rule, @rule_id, @severity, @desc, @payload_ref, @host)`
+    `INSERT INTO alerts (ts, src_ip, dst_ip, proto, rule, rule_id, severity, desc, payload_ref, host, iface, sample_rate)
+      VALUES (COALESCE(@ts, CURRENT_TIMESTAMP), @src_ip, @dst_ip, @proto, @rule, @rule_id, @severity, @desc, @payload_ref, @host, @iface, @sample_rate)`
   );
 
 
@@ -48,6 +50,8 @@ function ingestAlert(alert) {
     desc: alert.desc || null,
     payload_ref: alert.payload_ref || null,
     host: alert.host || null, 
+    iface: alert.iface || null,
+    sample_rate: typeof alert.sample_rate === "number" ? alert.sample_rate : null,
   });
 
   const insertedId = info.lastInsertRowid;
@@ -304,10 +308,10 @@ app.get("/api/rules/:id/audit", (req, res) => {
 function launchNIDSSensor() {
   const sensorPath = "../sensor/build/nids_sensor.exe";
 
-  logger.info({ event: "sensor_spawning", path: sensorPath, device_id: SENSOR_DEVICE_ID });
+  logger.info({ event: "sensor_spawning", path: sensorPath, device_ids: SENSOR_ARGS });
 
-  // 🔹 The sensor needs the device ID as an argument.
-  const nidsProcess = spawn(sensorPath, [SENSOR_DEVICE_ID], {
+  // 🔹 The sensor takes one device number per interface to capture.
+  const nidsProcess = spawn(sensorPath, SENSOR_ARGS, {
     cwd: process.cwd(),
     shell: false
   });
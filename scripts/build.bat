@@ -1,7 +1,7 @@
 @echo off
 echo "--- BUILDING C++ SENSOR ---"
 cd ../sensor
-$ g++ src/main.cpp src/packet_sniffer.cpp -I "C:/npcap-sdk/Include" -L "C:/npcap-sdk/Lib" -o build/nids_sensor.exe -lwpcap -lpacket -lws2_32 -O2
+$ g++ src/main.cpp src/packet_sniffer.cpp src/ip_reputation.cpp src/overload_controller.cpp src/dns_parser.cpp -std=c++17 -pthread -I "C:/npcap-sdk/Include" -L "C:/npcap-sdk/Lib" -o build/nids_sensor.exe -lwpcap -lpacket -lws2_32 -O2
 echo "--- INSTALLING BACKEND DEPENDENCIES ---"
 cd ../backend
 npm install
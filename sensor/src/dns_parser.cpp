@@ -0,0 +1,228 @@
+#include "dns_parser.h"
+
+#include <cmath>
+
+namespace
+{
+    constexpr int MAX_POINTER_HOPS = 16;
+
+    std::uint16_t load_be16(const std::uint8_t* p)
+    {
+        return static_cast<std::uint16_t>((p[0] << 8) | p[1]);
+    }
+
+    std::uint8_t ascii_lower(std::uint8_t c)
+    {
+        return (c >= 'A' && c <= 'Z') ? static_cast<std::uint8_t>(c | 0x20) : c;
+    }
+
+    // delta[c] = (c+1)*log2(c+1) - c*log2(c): growth of sum(c * log2 c)
+    // when one histogram bin goes from c to c+1 (names are <= 255 bytes)
+    struct NLogNDeltaTable
+    {
+        float delta[256];
+
+        NLogNDeltaTable()
+        {
+            auto nlogn = [](int n) { return n > 0 ? n * std::log2(static_cast<double>(n)) : 0.0; };
+            for (int c = 0; c < 256; ++c)
+            {
+                delta[c] = static_cast<float>(nlogn(c + 1) - nlogn(c));
+            }
+        }
+    };
+
+    const NLogNDeltaTable& nlogn_delta()
+    {
+        static const NLogNDeltaTable table;
+        return table;
+    }
+
+} // namespace
+
+
+
+// DnsMessage Implementation
+bool DnsMessage::parse(const std::uint8_t* data, std::size_t len)
+{
+    data_        = data;
+    len_         = len;
+    label_count_ = 0;
+    stats_       = NameStats{};
+
+    if (!data || len < HEADER_LEN)
+    {
+        return false;
+    }
+
+    id_      = load_be16(data + 0);
+    flags_   = load_be16(data + 2);
+    qdcount_ = load_be16(data + 4);
+    ancount_ = load_be16(data + 6);
+
+    if (qdcount_ == 0)
+    {
+        return false;
+    }
+
+    std::size_t end = 0;
+    if (!walk_qname(HEADER_LEN, end) || end + 4U > len_)
+    {
+        return false;
+    }
+
+    qtype_ = load_be16(data_ + end);
+    compute_stats();
+    return true;
+}
+
+// Record label positions of the name starting at `offset`. Compression
+// pointers must point backwards and are followed at most MAX_POINTER_HOPS
+// times; `end_offset` is the first byte after the name in the original
+// position (after the first pointer, if any).
+bool DnsMessage::walk_qname(std::size_t offset, std::size_t& end_offset)
+{
+    std::size_t pos      = offset;
+    std::size_t name_len = 0;
+    bool        jumped   = false;
+    int         hops     = 0;
+
+    for (;;)
+    {
+        if (pos >= len_)
+        {
+            return false;
+        }
+
+        const std::uint8_t b = data_[pos];
+
+        if ((b & 0xC0U) == 0xC0U)
+        {
+            if (pos + 1U >= len_ || ++hops > MAX_POINTER_HOPS)
+            {
+                return false;
+            }
+            const std::size_t target = (static_cast<std::size_t>(b & 0x3FU) << 8) | data_[pos + 1];
+            if (target >= pos)
+            {
+                return false;
+            }
+            if (!jumped)
+            {
+                end_offset = pos + 2U;
+                jumped     = true;
+            }
+            pos = target;
+            continue;
+        }
+
+        if ((b & 0xC0U) != 0)
+        {
+            return false; // extended / reserved label types
+        }
+
+        if (b == 0)
+        {
+            if (!jumped)
+            {
+                end_offset = pos + 1U;
+            }
+            break;
+        }
+
+        if (pos + 1U + b > len_ || label_count_ >= MAX_LABELS)
+        {
+            return false;
+        }
+
+        name_len += b + (label_count_ ? 1U : 0U);
+        if (name_len > 253U)
+        {
+            return false;
+        }
+
+        Label& label = labels_[label_count_++];
+        label.offset = static_cast<std::uint16_t>(pos + 1U);
+        label.len    = b;
+
+        if (b > stats_.max_label_len)
+        {
+            stats_.max_label_len = b;
+        }
+        pos += 1U + b;
+    }
+
+    stats_.labels   = label_count_;
+    stats_.name_len = static_cast<std::uint16_t>(name_len);
+    return true;
+}
+
+void DnsMessage::compute_stats()
+{
+    const std::size_t base_first = label_count_ >= 2 ? label_count_ - 2U : 0U;
+
+    // FNV-1a over the lower-cased base domain, '.'-joined
+    std::uint64_t hash = 1469598103934665603ULL;
+    for (std::size_t i = base_first; i < label_count_; ++i)
+    {
+        if (i != base_first)
+        {
+            hash = (hash ^ '.') * 1099511628211ULL;
+        }
+        const std::uint8_t* p = data_ + labels_[i].offset;
+        for (std::uint8_t j = 0; j < labels_[i].len; ++j)
+        {
+            hash = (hash ^ ascii_lower(p[j])) * 1099511628211ULL;
+        }
+    }
+    stats_.base_hash = hash;
+
+    // Character histogram of the subdomain part, case-folded so 0x20
+    // randomization does not look like encoded data. sum(c * log2 c) is
+    // accumulated per byte from a delta table instead of a 256-bin pass.
+    const float* delta = nlogn_delta().delta;
+    std::uint8_t counts[256] = {};
+    std::size_t  total       = 0;
+    float        sum         = 0.0f;
+    for (std::size_t i = 0; i < base_first; ++i)
+    {
+        const std::uint8_t* p = data_ + labels_[i].offset;
+        for (std::uint8_t j = 0; j < labels_[i].len; ++j)
+        {
+            std::uint8_t& c = counts[ascii_lower(p[j])];
+            sum += delta[c];
+            ++c;
+        }
+        total += labels_[i].len;
+    }
+    stats_.sub_len = static_cast<std::uint16_t>(total);
+
+    if (total == 0)
+    {
+        return;
+    }
+
+    // H = log2(N) - sum(c * log2 c) / N
+    const float n = static_cast<float>(total);
+    stats_.sub_entropy = std::log2(n) - sum / n;
+}
+
+std::string DnsMessage::base_domain() const
+{
+    std::string out;
+    const std::size_t base_first = label_count_ >= 2 ? label_count_ - 2U : 0U;
+    for (std::size_t i = base_first; i < label_count_; ++i)
+    {
+        if (!out.empty())
+        {
+            out += '.';
+        }
+        const std::uint8_t* p = data_ + labels_[i].offset;
+        for (std::uint8_t j = 0; j < labels_[i].len; ++j)
+        {
+            const std::uint8_t c = ascii_lower(p[j]);
+            out += (c >= 0x21 && c < 0x7F) ? static_cast<char>(c) : '?';
+        }
+    }
+    return out;
+}
@@ -0,0 +1,71 @@
+#ifndef DNS_PARSER_H
+#define DNS_PARSER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Zero-copy DNS message view.
+//
+// parse() validates the header and the first question in place: labels are
+// read straight out of the packet buffer (compression pointers included),
+// every read is bounds-checked and nothing is allocated. The buffer must
+// outlive the view.
+class DnsMessage
+{
+public:
+    static constexpr std::size_t HEADER_LEN = 12;
+    static constexpr std::size_t MAX_LABELS = 127;  // 255-byte name limit
+
+    // Label location inside the message buffer
+    struct Label
+    {
+        std::uint16_t offset = 0;
+        std::uint8_t  len    = 0;
+    };
+
+    // Statistics over the first question's name
+    struct NameStats
+    {
+        std::uint8_t  labels        = 0;
+        std::uint8_t  max_label_len = 0;
+        std::uint16_t name_len      = 0;   // presentation length without trailing dot
+        std::uint16_t sub_len       = 0;   // bytes left of the base domain
+        float         sub_entropy   = 0;   // Shannon entropy (bits/char) left of the base domain
+        std::uint64_t base_hash     = 0;   // FNV-1a of the lower-cased base domain (last two labels)
+    };
+
+    bool parse(const std::uint8_t* data, std::size_t len);
+
+    std::uint16_t id() const          { return id_; }
+    bool          is_response() const { return (flags_ & 0x8000U) != 0; }
+    std::uint8_t  rcode() const       { return static_cast<std::uint8_t>(flags_ & 0x000FU); }
+    std::uint16_t qdcount() const     { return qdcount_; }
+    std::uint16_t ancount() const     { return ancount_; }
+    std::uint16_t qtype() const       { return qtype_; }
+    std::size_t   size() const        { return len_; }
+
+    const NameStats& qname_stats() const { return stats_; }
+
+    // Base domain of the first question as text (allocates; for alert text only)
+    std::string base_domain() const;
+
+private:
+    bool walk_qname(std::size_t offset, std::size_t& end_offset);
+    void compute_stats();
+
+    const std::uint8_t* data_ = nullptr;
+    std::size_t         len_  = 0;
+
+    std::uint16_t id_      = 0;
+    std::uint16_t flags_   = 0;
+    std::uint16_t qdcount_ = 0;
+    std::uint16_t ancount_ = 0;
+    std::uint16_t qtype_   = 0;
+
+    Label         labels_[MAX_LABELS];
+    std::uint8_t  label_count_ = 0;
+    NameStats     stats_;
+};
+
+#endif  // DNS_PARSER_H
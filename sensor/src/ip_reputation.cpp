@@ -0,0 +1,441 @@
+#ifndef _WIN32_WINNT
+#define _WIN32_WINNT 0x0600
+#endif
+
+#define WIN32_LEAN_AND_MEAN
+
+#include "ip_reputation.h"
+
+#include <winsock2.h>
+#include <ws2tcpip.h>   // inet_pton
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <system_error>
+
+namespace
+{
+    using Clock = std::chrono::steady_clock;
+
+    constexpr auto RELOAD_POLL_INTERVAL = std::chrono::seconds(2);
+    constexpr int  BENCH_LOOKUPS        = 1 << 20;
+
+    PrefixTable::Key v4_key(std::uint32_t net_ip)
+    {
+        std::uint8_t bytes[4];
+        std::memcpy(bytes, &net_ip, sizeof(bytes));
+        const std::uint32_t host = (std::uint32_t{bytes[0]} << 24) | (std::uint32_t{bytes[1]} << 16) |
+                                   (std::uint32_t{bytes[2]} << 8)  |  std::uint32_t{bytes[3]};
+        PrefixTable::Key key;
+        key.hi = std::uint64_t{host} << 32;
+        return key;
+    }
+
+    // Zero every bit after the first `len` bits
+    void mask_key(PrefixTable::Key& key, unsigned len)
+    {
+        if (len == 0)
+        {
+            key.hi = key.lo = 0;
+        }
+        else if (len < 64)
+        {
+            key.hi &= ~std::uint64_t{0} << (64 - len);
+            key.lo = 0;
+        }
+        else if (len == 64)
+        {
+            key.lo = 0;
+        }
+        else if (len < 128)
+        {
+            key.lo &= ~std::uint64_t{0} << (128 - len);
+        }
+    }
+
+    std::string trim(const std::string& s)
+    {
+        const auto b = s.find_first_not_of(" \t\r\n");
+        if (b == std::string::npos) return std::string();
+        const auto e = s.find_last_not_of(" \t\r\n");
+        return s.substr(b, e - b + 1);
+    }
+
+    // Parse "a.b.c.d[/len]" into `v4`. Valid IPv6 prefixes are accepted
+    // but only counted in `v6_ignored`: the packet decoder is IPv4-only.
+    bool parse_cidr(const std::string& text,
+                    IpReputation value,
+                    std::vector<PrefixTable::Prefix>& v4,
+                    std::size_t& v6_ignored)
+    {
+        const auto slash = text.find('/');
+        const std::string addr = text.substr(0, slash);
+        const bool is_v6 = addr.find(':') != std::string::npos;
+        const unsigned max_len = is_v6 ? 128U : 32U;
+
+        unsigned len = max_len;
+        if (slash != std::string::npos)
+        {
+            const std::string len_str = text.substr(slash + 1);
+            if (len_str.empty() || len_str.size() > 3 ||
+                len_str.find_first_not_of("0123456789") != std::string::npos)
+            {
+                return false;
+            }
+            len = static_cast<unsigned>(std::stoul(len_str));
+            if (len > max_len) return false;
+        }
+
+        PrefixTable::Prefix p;
+        p.len   = static_cast<std::uint8_t>(len);
+        p.value = value;
+
+        if (is_v6)
+        {
+            std::uint8_t buf[16];
+            if (inet_pton(AF_INET6, addr.c_str(), buf) != 1) return false;
+            ++v6_ignored;
+        }
+        else
+        {
+            in_addr a{};
+            if (inet_pton(AF_INET, addr.c_str(), &a) != 1) return false;
+            p.key = v4_key(a.s_addr);
+            v4.push_back(p);
+        }
+        return true;
+    }
+
+    // Returns false when the file cannot be read or yields no prefix, which
+    // usually means it is missing or being rewritten
+    bool load_list_file(const std::string& path,
+                        IpReputation value,
+                        std::vector<PrefixTable::Prefix>& v4)
+    {
+        std::ifstream in(path);
+        if (!in.is_open())
+        {
+            std::cerr << "Warning: Could not open reputation list " << path << "\n";
+            return false;
+        }
+
+        const std::size_t before = v4.size();
+
+        std::string line;
+        std::size_t line_no    = 0;
+        std::size_t bad        = 0;
+        std::size_t v6_ignored = 0;
+        while (std::getline(in, line))
+        {
+            ++line_no;
+            const auto hash = line.find('#');
+            if (hash != std::string::npos) line.erase(hash);
+            line = trim(line);
+            if (line.empty()) continue;
+
+            if (!parse_cidr(line, value, v4, v6_ignored))
+            {
+                if (bad++ < 5)
+                {
+                    std::cerr << "Warning: " << path << ":" << line_no
+                              << ": invalid prefix '" << line << "'\n";
+                }
+            }
+        }
+        if (bad > 5)
+        {
+            std::cerr << "Warning: " << path << ": " << bad << " invalid prefixes skipped\n";
+        }
+
+        if (v6_ignored > 0)
+        {
+            std::cerr << "Warning: " << path << ": " << v6_ignored
+                      << " IPv6 prefixes ignored (only IPv4 traffic is decoded)\n";
+        }
+
+        // An IPv6-only list is valid input, it just matches nothing yet
+        if (in.bad() || v4.size() + v6_ignored == before)
+        {
+            std::cerr << "Warning: reputation list " << path << " is unreadable or empty\n";
+            return false;
+        }
+        return true;
+    }
+
+    // On-disk identity of one list file; a missing file compares as zero
+    struct ListFileState
+    {
+        std::filesystem::file_time_type mtime{};
+        std::uintmax_t                  size = 0;
+
+        bool operator==(const ListFileState& o) const { return mtime == o.mtime && size == o.size; }
+    };
+
+    // Per-file state, so a replacement that carries an older mtime than
+    // another list (rsync -a, curl -R, then rename) is still noticed
+    std::vector<ListFileState> list_file_states(const std::vector<std::string>& paths)
+    {
+        std::vector<ListFileState> states(paths.size());
+        for (std::size_t i = 0; i < paths.size(); ++i)
+        {
+            std::error_code ec;
+            const auto t = std::filesystem::last_write_time(paths[i], ec);
+            if (ec) continue;
+            const auto size = std::filesystem::file_size(paths[i], ec);
+            states[i].mtime = t;
+            states[i].size  = ec ? 0 : size;
+        }
+        return states;
+    }
+
+} // namespace
+
+
+
+// PrefixTable Implementation
+void PrefixTable::build(std::vector<Prefix> prefixes)
+{
+    nodes_.clear();
+    leaves_.clear();
+    default_      = IpReputation::Unknown;
+    prefix_count_ = 0;
+
+    for (auto& p : prefixes)
+    {
+        if (p.len > 128) p.len = 128;
+        mask_key(p.key, p.len);
+    }
+
+    std::sort(prefixes.begin(), prefixes.end(), [](const Prefix& a, const Prefix& b) {
+        if (a.key.hi != b.key.hi) return a.key.hi < b.key.hi;
+        if (a.key.lo != b.key.lo) return a.key.lo < b.key.lo;
+        if (a.len != b.len)       return a.len < b.len;
+        return a.value < b.value;
+    });
+
+    // Collapse duplicates, keeping the highest tag (sorted last)
+    auto same_prefix = [](const Prefix& a, const Prefix& b) {
+        return a.key.hi == b.key.hi && a.key.lo == b.key.lo && a.len == b.len;
+    };
+    std::vector<Prefix> unique;
+    unique.reserve(prefixes.size());
+    for (const auto& p : prefixes)
+    {
+        if (!unique.empty() && same_prefix(unique.back(), p))
+            unique.back() = p;
+        else
+            unique.push_back(p);
+    }
+
+    for (const auto& p : unique)
+    {
+        if (p.len == 0) default_ = p.value;
+    }
+    prefix_count_ = unique.size();
+
+    nodes_.emplace_back();
+    build_node(0, unique.data(), unique.data() + unique.size(), 0, default_);
+
+    nodes_.shrink_to_fit();
+    leaves_.shrink_to_fit();
+}
+
+void PrefixTable::build_node(std::uint32_t node_idx,
+                             const Prefix* first,
+                             const Prefix* last,
+                             unsigned      depth,
+                             IpReputation  inherited)
+{
+    constexpr unsigned SLOTS = 1U << STRIDE;
+
+    IpReputation  slot_val[SLOTS];
+    int           slot_len[SLOTS];
+    const Prefix* child_first[SLOTS] = {};
+    const Prefix* child_last[SLOTS]  = {};
+
+    std::fill(std::begin(slot_val), std::end(slot_val), inherited);
+    std::fill(std::begin(slot_len), std::end(slot_len), -1);
+
+    // Prefixes ending inside this node expand over the slots they cover;
+    // longer prefixes are grouped by slot (input is sorted by key).
+    for (const Prefix* p = first; p != last; ++p)
+    {
+        if (p->len <= depth) continue;  // already applied by an ancestor
+
+        const std::uint32_t slot = extract_bits(p->key, depth);
+        if (p->len <= depth + STRIDE)
+        {
+            const std::uint32_t span = 1U << (depth + STRIDE - p->len);
+            for (std::uint32_t s = slot; s < slot + span; ++s)
+            {
+                if (p->len > slot_len[s])
+                {
+                    slot_len[s] = p->len;
+                    slot_val[s] = p->value;
+                }
+            }
+        }
+        else
+        {
+            if (!child_first[slot]) child_first[slot] = p;
+            child_last[slot] = p + 1;
+        }
+    }
+
+    Node node;
+    node.base0 = static_cast<std::uint32_t>(leaves_.size());
+
+    bool         have_prev = false;
+    IpReputation prev      = IpReputation::Unknown;
+    for (unsigned s = 0; s < SLOTS; ++s)
+    {
+        const std::uint64_t bit = std::uint64_t{1} << s;
+        if (child_first[s])
+        {
+            node.vector |= bit;
+        }
+        else if (!have_prev || slot_val[s] != prev)
+        {
+            node.leafvec |= bit;
+            leaves_.push_back(slot_val[s]);
+            prev      = slot_val[s];
+            have_prev = true;
+        }
+    }
+
+    // Children are reserved as one contiguous block before recursing
+    node.base1 = static_cast<std::uint32_t>(nodes_.size());
+    nodes_.resize(nodes_.size() + popcount64(node.vector));
+    nodes_[node_idx] = node;
+
+    std::uint32_t child = node.base1;
+    for (unsigned s = 0; s < SLOTS; ++s)
+    {
+        if (child_first[s])
+        {
+            build_node(child++, child_first[s], child_last[s], depth + STRIDE, slot_val[s]);
+        }
+    }
+}
+
+
+
+// IpReputationTable Implementation
+std::shared_ptr<const IpReputationTable> IpReputationTable::load(
+    const std::vector<std::string>& blocklists,
+    const std::vector<std::string>& allowlists)
+{
+    std::vector<PrefixTable::Prefix> v4;
+
+    bool complete = true;
+    for (const auto& path : blocklists) complete &= load_list_file(path, IpReputation::Block, v4);
+    for (const auto& path : allowlists) complete &= load_list_file(path, IpReputation::Allow, v4);
+    if (!complete)
+    {
+        return nullptr;
+    }
+
+    auto table = std::make_shared<IpReputationTable>();
+    table->v4_.build(std::move(v4));
+    return table;
+}
+
+IpReputation IpReputationTable::lookup_v4(std::uint32_t net_ip) const
+{
+    return v4_.lookup(v4_key(net_ip));
+}
+
+
+
+// IpReputationService Implementation
+IpReputationService::IpReputationService(std::vector<std::string> blocklists,
+                                         std::vector<std::string> allowlists)
+    : blocklists_(std::move(blocklists)),
+      allowlists_(std::move(allowlists))
+{
+    if (empty())
+    {
+        return;
+    }
+
+    reload();
+    watcher_ = std::thread(&IpReputationService::watch_loop, this);
+}
+
+IpReputationService::~IpReputationService()
+{
+    stop_ = true;
+    if (watcher_.joinable())
+    {
+        watcher_.join();
+    }
+}
+
+void IpReputationService::reload()
+{
+    const auto build_start = Clock::now();
+    auto table = IpReputationTable::load(blocklists_, allowlists_);
+    const auto build_ms =
+        std::chrono::duration_cast<std::chrono::milliseconds>(Clock::now() - build_start).count();
+
+    // Never publish a partial table: a list caught mid-rewrite would
+    // silently drop blocklist coverage until the next change
+    if (!table)
+    {
+        std::cerr << (snapshot() ? "Reputation reload failed, keeping previous lists\n"
+                                 : "Reputation lists not loaded, reputation checks disabled\n");
+        return;
+    }
+
+    // Quick lookup benchmark over pseudo-random IPv4 addresses (xorshift32)
+    std::uint32_t x    = 2463534242U;
+    std::size_t   hits = 0;
+    const auto bench_start = Clock::now();
+    for (int i = 0; i < BENCH_LOOKUPS; ++i)
+    {
+        x ^= x << 13;
+        x ^= x >> 17;
+        x ^= x << 5;
+        hits += table->lookup_v4(x) != IpReputation::Unknown;
+    }
+    const double bench_s =
+        std::chrono::duration<double>(Clock::now() - bench_start).count();
+
+    std::cerr << "Reputation lists loaded: " << table->prefix_count() << " prefixes, "
+              << (table->memory_bytes() / 1024) << " KiB, built in " << build_ms << " ms, "
+              << static_cast<long long>(bench_s > 0 ? BENCH_LOOKUPS / bench_s : 0)
+              << " IPv4 lookups/s (" << hits << " hits)\n";
+
+    std::atomic_store_explicit(&table_,
+                               std::shared_ptr<const IpReputationTable>(std::move(table)),
+                               std::memory_order_release);
+}
+
+void IpReputationService::watch_loop()
+{
+    std::vector<std::string> all = blocklists_;
+    all.insert(all.end(), allowlists_.begin(), allowlists_.end());
+
+    auto last_states = list_file_states(all);
+    auto next_poll  = Clock::now() + RELOAD_POLL_INTERVAL;
+
+    while (!stop_)
+    {
+        std::this_thread::sleep_for(std::chrono::milliseconds(200));
+        if (Clock::now() < next_poll)
+        {
+            continue;
+        }
+        next_poll = Clock::now() + RELOAD_POLL_INTERVAL;
+
+        auto states = list_file_states(all);
+        if (states != last_states)
+        {
+            last_states = std::move(states);
+            reload();
+        }
+    }
+}
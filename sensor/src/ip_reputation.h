@@ -0,0 +1,178 @@
+#ifndef IP_REPUTATION_H
+#define IP_REPUTATION_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Reputation tag attached to an address by the loaded CIDR lists
+enum class IpReputation : std::uint8_t
+{
+    Unknown = 0,
+    Allow   = 1,
+    Block   = 2,
+};
+
+// Longest-prefix-match table (poptrie layout).
+//
+// Each internal node covers 6 bits of the key and stores two 64-bit bitmaps:
+// `vector` marks slots that descend into a child node, `leafvec` marks slots
+// where the leaf value changes. Children and leaves of a node are stored
+// contiguously, so a slot is resolved with one popcount and one array index.
+// IPv4 lookups touch at most 6 nodes, IPv6 at most 22.
+class PrefixTable
+{
+public:
+    // 128-bit key, most significant bits first. IPv4 lives in the top 32 bits of `hi`.
+    struct Key
+    {
+        std::uint64_t hi = 0;
+        std::uint64_t lo = 0;
+    };
+
+    struct Prefix
+    {
+        Key           key;
+        std::uint8_t  len   = 0;
+        IpReputation  value = IpReputation::Unknown;
+    };
+
+    // Build from an unsorted prefix list. Overlapping prefixes resolve by
+    // longest match; identical prefixes resolve to the highest tag value.
+    void build(std::vector<Prefix> prefixes);
+
+    IpReputation lookup(const Key& key) const
+    {
+        if (nodes_.empty())
+        {
+            return default_;
+        }
+
+        const Node*   node = &nodes_[0];
+        unsigned      off  = 0;
+        for (;;)
+        {
+            const std::uint32_t  slot = extract_bits(key, off);
+            const std::uint64_t  bit  = std::uint64_t{1} << slot;
+            const std::uint64_t  mask = (bit << 1) - 1;  // slots [0, slot]; wraps to all-ones at 63
+
+            if (node->vector & bit)
+            {
+                node = &nodes_[node->base1 + popcount64(node->vector & mask) - 1];
+                off += STRIDE;
+                continue;
+            }
+            return leaves_[node->base0 + popcount64(node->leafvec & mask) - 1];
+        }
+    }
+
+    std::size_t prefix_count() const { return prefix_count_; }
+    std::size_t memory_bytes() const
+    {
+        return nodes_.capacity() * sizeof(Node) + leaves_.capacity() * sizeof(IpReputation);
+    }
+
+private:
+    static constexpr unsigned STRIDE = 6;
+
+    struct Node
+    {
+        std::uint64_t vector  = 0;
+        std::uint64_t leafvec = 0;
+        std::uint32_t base0   = 0;  // index of first leaf in leaves_
+        std::uint32_t base1   = 0;  // index of first child in nodes_
+    };
+
+    static std::uint32_t extract_bits(const Key& key, unsigned off)
+    {
+        std::uint64_t word;
+        if (off == 0)
+            word = key.hi;
+        else if (off < 64)
+            word = (key.hi << off) | (key.lo >> (64 - off));
+        else
+            word = key.lo << (off - 64);
+        return static_cast<std::uint32_t>(word >> (64 - STRIDE));
+    }
+
+    static unsigned popcount64(std::uint64_t v)
+    {
+        return static_cast<unsigned>(__builtin_popcountll(v));
+    }
+
+    void build_node(std::uint32_t node_idx,
+                    const Prefix* first,
+                    const Prefix* last,
+                    unsigned      depth,
+                    IpReputation  inherited);
+
+    std::vector<Node>         nodes_;
+    std::vector<IpReputation> leaves_;
+    IpReputation              default_     = IpReputation::Unknown;
+    std::size_t               prefix_count_ = 0;
+};
+
+// Immutable IPv4 reputation snapshot built from allow/block list files
+class IpReputationTable
+{
+public:
+    // Parse the given CIDR list files (one prefix per line, '#' comments).
+    // Malformed lines are reported on stderr and skipped, IPv6 prefixes are
+    // counted and ignored; returns null if any file cannot be opened or
+    // contains no valid prefix.
+    static std::shared_ptr<const IpReputationTable> load(
+        const std::vector<std::string>& blocklists,
+        const std::vector<std::string>& allowlists);
+
+    // Address in network byte order, as it appears in the IP header
+    IpReputation lookup_v4(std::uint32_t net_ip) const;
+
+    std::size_t prefix_count() const { return v4_.prefix_count(); }
+    std::size_t memory_bytes() const { return v4_.memory_bytes(); }
+
+private:
+    PrefixTable v4_;
+};
+
+// Owns the current reputation snapshot and swaps in a rebuilt one whenever a
+// list file changes on disk. snapshot() is an atomic shared_ptr load (a
+// pooled lock in libstdc++), so capture threads call it once per batch and
+// keep the result, never per packet.
+class IpReputationService
+{
+public:
+    IpReputationService(std::vector<std::string> blocklists,
+                        std::vector<std::string> allowlists);
+    ~IpReputationService();
+
+    IpReputationService(const IpReputationService&) = delete;
+    IpReputationService& operator=(const IpReputationService&) = delete;
+
+    bool empty() const { return blocklists_.empty() && allowlists_.empty(); }
+
+    std::shared_ptr<const IpReputationTable> snapshot() const
+    {
+        return std::atomic_load_explicit(&table_, std::memory_order_acquire);
+    }
+
+    // Rebuild from disk and publish the result; the previous snapshot is
+    // kept if any list is missing, unreadable or empty
+    void reload();
+
+private:
+    void watch_loop();
+
+    std::vector<std::string> blocklists_;
+    std::vector<std::string> allowlists_;
+
+    std::shared_ptr<const IpReputationTable> table_;
+
+    std::atomic<bool> stop_{false};
+    std::thread       watcher_;
+};
+
+#endif  // IP_REPUTATION_H
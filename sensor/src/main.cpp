@@ -1,29 +1,38 @@
 // src/main.cpp
 #include "packet_sniffer.h"
+#include "ip_reputation.h"
 
+#include <atomic>
 #include <csignal>
 #include <cstdlib>
 #include <exception>
 #include <iostream>
 #include <string>
+#include <vector>
 
 namespace
 {
     volatile sig_atomic_t g_stop_requested = 0;
+    std::atomic<PacketSniffer*> g_sniffer{nullptr};
 
     void handle_sigint(int)
     {
         g_stop_requested = 1;
         std::cerr << "\nSIGINT received — shutting down...\n";
-        // If PacketSniffer exposes a stop() that calls pcap_breakloop(),
-        // you could call it here (via some global pointer or other mechanism).
+        if (PacketSniffer* sniffer = g_sniffer.load())
+        {
+            sniffer->stop();
+        }
     }
 
     void print_usage(const char* progname)
     {
-        std::cerr << "Usage: " << progname << " [device_number]\n"
-                  << "  device_number : 1-based index of the capture device (default: 1)\n"
-                  << "  -h, --help    : show this message\n";
+        std::cerr << "Usage: " << progname << " [device_number]... [--read FILE]... [--blocklist FILE]... [--allowlist FILE]...\n"
+                  << "  device_number    : 1-based index of a capture device, repeat for more (default: 1)\n"
+                  << "  --read FILE      : replay a pcap file as an additional interface\n"
+                  << "  --blocklist FILE : CIDR list of known-bad hosts (IPv4, reloaded on change)\n"
+                  << "  --allowlist FILE : CIDR list of trusted ranges; packets they send are not inspected\n"
+                  << "  -h, --help       : show this message\n";
     }
 
 } // namespace
@@ -32,11 +41,13 @@ int main(int argc, char* argv[])
 {
     std::signal(SIGINT, handle_sigint);
 
-    int dev_num = 1;
+    std::vector<CaptureSource> sources;
+    std::vector<std::string> blocklists;
+    std::vector<std::string> allowlists;
 
-    if (argc > 1)
+    for (int i = 1; i < argc; ++i)
     {
-        const std::string arg = argv[1];
+        const std::string arg = argv[i];
 
         if (arg == "-h" || arg == "--help")
         {
@@ -44,6 +55,32 @@ int main(int argc, char* argv[])
             return EXIT_SUCCESS;
         }
 
+        if (arg == "--read")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing file after " << arg << '\n';
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            CaptureSource src;
+            src.replay_file = argv[++i];
+            sources.push_back(src);
+            continue;
+        }
+
+        if (arg == "--blocklist" || arg == "--allowlist")
+        {
+            if (i + 1 >= argc)
+            {
+                std::cerr << "Missing file after " << arg << '\n';
+                print_usage(argv[0]);
+                return EXIT_FAILURE;
+            }
+            (arg == "--blocklist" ? blocklists : allowlists).push_back(argv[++i]);
+            continue;
+        }
+
         try
         {
             std::size_t pos = 0;
@@ -56,7 +93,9 @@ int main(int argc, char* argv[])
                 return EXIT_FAILURE;
             }
 
-            dev_num = static_cast<int>(tmp);
+            CaptureSource src;
+            src.device_num = static_cast<int>(tmp);
+            sources.push_back(src);
         }
         catch (const std::exception& e)
         {
@@ -65,20 +104,27 @@ int main(int argc, char* argv[])
             return EXIT_FAILURE;
         }
     }
-    else
+
+    if (sources.empty())
     {
         std::cerr << "No device number specified, defaulting to 1.\n";
+        CaptureSource src;
+        src.device_num = 1;
+        sources.push_back(src);
     }
 
     try
     {
-        PacketSniffer sniffer(dev_num);
-        // Assuming PacketSniffer has a public check like is_ready() or is_open()
-        // If not, the sniffer.start_sniffing() call will handle the failure (which is fine, but less explicit)
+        IpReputationService reputation(blocklists, allowlists);
+        PacketSniffer sniffer(sources, reputation.empty() ? nullptr : &reputation);
+        // start_sniffing() reports and returns if no interface could be opened
+        g_sniffer = &sniffer;
         sniffer.start_sniffing();
+        g_sniffer = nullptr;
     }
     catch (const std::exception& e)
     {
+        g_sniffer = nullptr;
         std::cerr << "An error occurred: " << e.what() << '\n';
         return EXIT_FAILURE;
     }
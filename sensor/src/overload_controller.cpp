@@ -0,0 +1,49 @@
+#include "overload_controller.h"
+
+#include <algorithm>
+
+// OverloadController Implementation
+bool OverloadController::update(std::uint64_t                       kernel_drops,
+                                std::chrono::steady_clock::duration idle,
+                                std::chrono::steady_clock::duration elapsed)
+{
+    // First sample only establishes the drop baseline
+    const std::uint64_t new_drops = have_drops_ && kernel_drops > last_drops_
+                                  ? kernel_drops - last_drops_
+                                  : 0;
+    last_drops_ = kernel_drops;
+    have_drops_ = true;
+
+    const std::uint32_t rate = rate_.load(std::memory_order_relaxed);
+    std::uint32_t       next = rate;
+
+    const bool busy = idle * 100 < elapsed * IDLE_BUSY_PERCENT;
+    const bool calm = idle * 100 >= elapsed * IDLE_CALM_PERCENT;
+
+    if (new_drops > 0 || busy)
+    {
+        // Multiplicative decrease: react fast, the kernel is already losing packets
+        calm_streak_ = 0;
+        next = std::max(MIN_RATE, rate / 2);
+    }
+    else if (calm)
+    {
+        // Additive increase after a sustained quiet period
+        if (++calm_streak_ >= CALM_TO_RECOVER && rate < FULL_RATE)
+        {
+            calm_streak_ = 0;
+            next = std::min(FULL_RATE, rate + FULL_RATE / 16);
+        }
+    }
+    else
+    {
+        calm_streak_ = 0;
+    }
+
+    if (next == rate)
+    {
+        return false;
+    }
+    rate_.store(next, std::memory_order_relaxed);
+    return true;
+}
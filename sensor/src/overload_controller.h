@@ -0,0 +1,62 @@
+#ifndef OVERLOAD_CONTROLLER_H
+#define OVERLOAD_CONTROLLER_H
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Per-interface load shedding for when detection falls behind the link.
+//
+// The controller watches two overload signals: new kernel drops reported by
+// pcap_stats, and the capture thread's idle share (time spent blocked in
+// pcap_dispatch waiting for the driver, on steady_clock). A thread that
+// almost never waits is not keeping up with the link; neither signal
+// compares driver timestamps with the system clock. While overloaded it
+// halves the share of established-flow data packets that are processed;
+// once both signals stay quiet it recovers in small steps.
+// Control traffic is never shed, that decision is made by the caller.
+class OverloadController
+{
+public:
+    // Share of data packets admitted, in 1/65536 units
+    static constexpr std::uint32_t FULL_RATE = 1U << 16;
+    static constexpr std::uint32_t MIN_RATE  = FULL_RATE / 256;
+
+    // Per-flow consistent decision: a flow hash is either always admitted
+    // or always shed at a given rate, so sampled flows stay complete.
+    bool admit(std::uint32_t flow_hash) const
+    {
+        return (flow_hash & 0xFFFFU) < rate_.load(std::memory_order_relaxed);
+    }
+
+    bool shedding() const { return rate_.load(std::memory_order_relaxed) < FULL_RATE; }
+
+    // Effective sampling rate for data packets, in (0, 1]
+    double sample_rate() const
+    {
+        return static_cast<double>(rate_.load(std::memory_order_relaxed)) / FULL_RATE;
+    }
+
+    // Feed the latest signals, about once per EVAL_INTERVAL; returns true
+    // when the sampling rate changed. `kernel_drops` is the cumulative
+    // pcap_stats drop counter, `idle` is how long the capture thread waited
+    // for packets during the `elapsed` time since the previous call.
+    bool update(std::uint64_t                       kernel_drops,
+                std::chrono::steady_clock::duration idle,
+                std::chrono::steady_clock::duration elapsed);
+
+    static constexpr auto EVAL_INTERVAL = std::chrono::milliseconds(250);
+
+private:
+    static constexpr int IDLE_BUSY_PERCENT = 2;   // below: the buffer is never drained
+    static constexpr int IDLE_CALM_PERCENT = 20;  // at or above: headroom to admit more
+    static constexpr int CALM_TO_RECOVER   = 4;   // quiet intervals before stepping up
+
+    std::atomic<std::uint32_t> rate_{FULL_RATE};
+
+    std::uint64_t last_drops_  = 0;
+    bool          have_drops_  = false;
+    int           calm_streak_ = 0;
+};
+
+#endif  // OVERLOAD_CONTROLLER_H
@@ -5,6 +5,8 @@
 #define WIN32_LEAN_AND_MEAN
 
 #include "packet_sniffer.h"
+#include "ip_reputation.h"
+#include "dns_parser.h"
 #define _WIN32_WINNT 0x0600
 #define WIN32_LEAN_AND_MEAN
 #define _WINSOCK_DEPRECATED_NO_WARNING
@@ -12,6 +14,8 @@
 #include <pcap.h>
 #include <winsock2.h>
 #include <ws2tcpip.h>   // getnameinfo, NI_* macros, InetPton/InetNtop on Windows
+#include <algorithm>
+#include <array>
 #include <chrono>
 #include <cstdint>
 #include <cstring>
@@ -22,11 +26,12 @@
 #include <string>
 #include <unordered_map>
 #include <unordered_set>
+#include <utility>
 #include <iomanip>
+#include <mutex>
+#include <thread>
 #include <windows.h>
 
-// MUTEX INCLUDE REMOVED
-
 #ifndef TH_SYN
 #define TH_FIN  0x01
 #define TH_SYN  0x02
@@ -45,7 +50,95 @@ extern "C" {
 namespace
 {
     using Clock     = std::chrono::steady_clock;
-    using TimePoint = Clock::time_point;
+
+    // Detection windows run on capture timestamps (pkthdr->ts), so a batch
+    // delivered late or a replay file still sees the real packet spacing
+    using PacketClock = std::chrono::system_clock;
+    using TimePoint   = PacketClock::time_point;
+
+    // murmur3 fmix64 finalizer: spreads every input bit over the result
+    std::uint64_t fmix64(std::uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xFF51AFD7ED558CCDULL;
+        h ^= h >> 33;
+        h *= 0xC4CEB9FE1A85EC53ULL;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // Hash map split into independently locked shards so capture threads
+    // only contend when they touch the same shard, never on a global lock.
+    template <typename Key, typename Value, std::size_t Shards = 64>
+    class ShardedMap
+    {
+    public:
+        // Run `fn(map)` on the shard owning `key` with that shard's lock held.
+        // std::hash is the identity for integers, and network-order addresses
+        // would pick the shard by their first octet, so the hash is mixed first.
+        template <typename Fn>
+        auto with_shard(const Key& key, Fn&& fn)
+        {
+            Shard& shard = shards_[fmix64(std::hash<Key>{}(key)) % Shards];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+            return fn(shard.map);
+        }
+
+        // Run `fn(record)` on the record for `key`, creating it if needed.
+        // A shard holds at most `ShardLimit` records: when a new key finds it
+        // full, records older than `window` are dropped (at most one sweep
+        // per shard and window) and, if that frees nothing, an arbitrary
+        // record is evicted. Inserts never rescan a full shard per packet.
+        template <typename Window, typename Fn>
+        auto with_record(const Key& key, TimePoint now, Window window, Fn&& fn)
+        {
+            Shard& shard = shards_[fmix64(std::hash<Key>{}(key)) % Shards];
+            std::lock_guard<std::mutex> lock(shard.mutex);
+
+            auto it = shard.map.find(key);
+            if (it == shard.map.end())
+            {
+                if (shard.map.size() >= ShardLimit)
+                {
+                    evict(shard, now, window);
+                }
+                it = shard.map.emplace(key, Value{}).first;
+            }
+            return fn(it->second);
+        }
+
+    private:
+        static constexpr std::size_t ShardLimit = 4096;
+
+        struct alignas(64) Shard
+        {
+            std::mutex                     mutex;
+            std::unordered_map<Key, Value> map;
+            TimePoint                      last_sweep = {};
+        };
+
+        template <typename Window>
+        static void evict(Shard& shard, TimePoint now, Window window)
+        {
+            if (now - shard.last_sweep >= window)
+            {
+                shard.last_sweep = now;
+                for (auto it = shard.map.begin(); it != shard.map.end();)
+                {
+                    if (now - it->second.first_seen > window)
+                        it = shard.map.erase(it);
+                    else
+                        ++it;
+                }
+            }
+            if (shard.map.size() >= ShardLimit)
+            {
+                shard.map.erase(shard.map.begin());
+            }
+        }
+
+        std::array<Shard, Shards> shards_;
+    };
 
     // Simple TCP SYN tracking record
     struct TCPScanRecord
@@ -54,17 +147,299 @@ namespace
         TimePoint first_seen = {};
     };
 
-    // Global trackers (NO MUTEX GUARD)
-    static std::unordered_map<std::string, std::pair<std::string, TimePoint>> g_dns_cache;
+    // ICMP rate tracking record
+    struct ICMPRecord
+    {
+        int       count      = 0;
+        TimePoint first_seen = {};
+    };
+
+    // Global trackers, shared by all capture interfaces so that activity
+    // seen on several interfaces correlates in one record
+    struct DNSCacheRecord
+    {
+        std::string host;
+        TimePoint   first_seen = {};
+    };
+    static ShardedMap<std::string, DNSCacheRecord> g_dns_cache;
     static constexpr auto DNS_CACHE_TTL = std::chrono::minutes(10);
-    static std::unordered_map<std::string, TCPScanRecord> scan_tracker;
-    // Mutexes removed
+    static ShardedMap<std::string, TCPScanRecord> scan_tracker;
+    static ShardedMap<std::string, ICMPRecord>    icmp_tracker;
+
+    // Per client and base-domain DNS query statistics (tunneling heuristics)
+    struct DNSDomainRecord
+    {
+        int           queries     = 0;
+        std::uint32_t sub_len_sum = 0;
+        float         entropy_sum = 0;
+        TimePoint     first_seen  = {};
+    };
+
+    // Per-client DNS volume (amplification heuristics)
+    struct DNSVolumeRecord
+    {
+        std::uint64_t request_bytes  = 0;
+        std::uint64_t response_bytes = 0;
+        TimePoint     first_seen     = {};
+    };
+
+    // UDP packet rate per src->dst pair
+    struct UDPFloodRecord
+    {
+        int       packets    = 0;
+        TimePoint first_seen = {};
+    };
+
+    static ShardedMap<std::uint64_t, DNSDomainRecord> dns_domain_tracker;  // key: mix of client address and base domain hash
+    static ShardedMap<std::uint32_t, DNSVolumeRecord> dns_volume_tracker;  // key: client address
+    static ShardedMap<std::uint64_t, UDPFloodRecord>  udp_tracker;         // key: src << 32 | dst
+
+    static constexpr auto          DNS_WINDOW             = std::chrono::seconds(10);
+    static constexpr int           DNS_TUNNEL_MIN_QUERIES = 30;
+    static constexpr int           DNS_TUNNEL_MIN_SUB_LEN = 30;    // avg bytes left of the base domain
+    static constexpr float         DNS_TUNNEL_MIN_ENTROPY = 3.5f;  // avg bits per char
+    static constexpr std::uint64_t DNS_AMP_MIN_BYTES      = 64 * 1024;
+    static constexpr std::uint64_t DNS_AMP_MIN_RATIO      = 10;
+
+    static constexpr auto UDP_FLOOD_WINDOW    = std::chrono::seconds(5);
+    static constexpr int  UDP_FLOOD_THRESHOLD = 1000;
+
+    // Last "known-bad host" alert per blocklisted address (network order)
+    struct ReputationAlertRecord
+    {
+        TimePoint first_seen = {};  // time of the last alert
+    };
+    static ShardedMap<std::uint32_t, ReputationAlertRecord> g_reputation_alerts;
+    static constexpr auto REPUTATION_ALERT_COOLDOWN = std::chrono::seconds(60);
+
+    // First copy of each packet routed between two monitored interfaces.
+    // The key covers the fields forwarding leaves unchanged (addresses,
+    // IP ID, length, start of the L4 header; not TTL or checksum), so a
+    // LAN->DMZ packet captured on both sides is counted once. NATed
+    // traffic changes addresses and is not matched.
+    struct ForwardRecord
+    {
+        TimePoint   first_seen = {};
+        const void* iface      = nullptr;  // interface that saw the first copy
+    };
+    static ShardedMap<std::uint64_t, ForwardRecord> g_forwarded;
+    static constexpr auto FORWARD_DEDUP_WINDOW = std::chrono::milliseconds(50);
+
+    // Interval between per-interface counter reports on stderr
+    static constexpr auto STATS_INTERVAL = std::chrono::seconds(30);
+
+    // Ports whose traffic always raises an alert (SSH, RDP): never shed
+    // under load and never dropped by the kernel filter
+    constexpr std::array<std::uint16_t, 2> SENSITIVE_PORTS{22, 3389};
+
+    bool is_sensitive_port(std::uint16_t port)
+    {
+        return std::find(SENSITIVE_PORTS.begin(), SENSITIVE_PORTS.end(), port) != SENSITIVE_PORTS.end();
+    }
+
+    // Direction-independent 5-tuple hash so both halves of a flow get the
+    // same sampling decision
+    std::uint32_t flow_hash(std::uint32_t a, std::uint32_t b,
+                            std::uint16_t pa, std::uint16_t pb,
+                            std::uint8_t proto)
+    {
+        if (a > b || (a == b && pa > pb))
+        {
+            std::swap(a, b);
+            std::swap(pa, pb);
+        }
+        std::uint64_t h = (std::uint64_t{a} << 32) | b;
+        h ^= ((std::uint64_t{pa} << 24) | (std::uint64_t{pb} << 8) | proto) * 0x9E3779B97F4A7C15ULL;
+        return static_cast<std::uint32_t>(fmix64(h));
+    }
+
+    // Helper: forwarding-invariant identity of an IPv4 packet. `ip_len` is
+    // the number of captured bytes from the start of the IP header.
+    std::uint64_t forwarded_packet_key(const u_char* ip, std::size_t ip_header_len, std::size_t ip_len)
+    {
+        std::uint64_t addrs  = 0;
+        std::uint64_t fields = 0;  // total length, ID, flags/fragment offset
+        std::memcpy(&addrs,  ip + 12, sizeof(addrs));
+        std::memcpy(&fields, ip + 2,  6);
+        fields |= std::uint64_t{ip[9]} << 48;
+
+        // TCP ports + sequence, UDP ports + length + checksum, ICMP type..sequence
+        std::uint64_t l4 = 0;
+        if (ip_len >= ip_header_len + 8U)
+        {
+            std::memcpy(&l4, ip + ip_header_len, sizeof(l4));
+        }
+        return fmix64(fmix64(addrs ^ fields * 0x9E3779B97F4A7C15ULL) ^ l4);
+    }
+
+    // Helper: true when another interface saw this packet within the
+    // dedup window. Repeats on the same interface are real traffic.
+    bool is_forwarded_copy(const void* iface, std::uint64_t key, TimePoint now)
+    {
+        return g_forwarded.with_record(key, now, FORWARD_DEDUP_WINDOW, [&](auto& rec)
+        {
+            if (rec.iface && rec.iface != iface &&
+                std::chrono::abs(now - rec.first_seen) <= FORWARD_DEDUP_WINDOW)
+            {
+                return true;
+            }
+            rec.first_seen = now;
+            rec.iface      = iface;
+            return false;
+        });
+    }
+
+    // Helper: decide whether a packet may be shed. ICMP, TCP SYN/RST/FIN,
+    // DNS, sensitive ports and truncated headers always pass; other packets
+    // are sampled by flow hash.
+    bool may_shed(const OverloadController& overload,
+                  std::uint8_t  proto,
+                  std::uint32_t src_addr_net,
+                  std::uint32_t dst_addr_net,
+                  const u_char* l4,
+                  std::size_t   l4_len)
+    {
+        if (proto != 6 && proto != 17)
+        {
+            return false;
+        }
+        if (l4_len < 4U)
+        {
+            return false;
+        }
+
+        std::uint16_t src_port_net = 0;
+        std::uint16_t dst_port_net = 0;
+        std::memcpy(&src_port_net, l4 + 0, sizeof(src_port_net));
+        std::memcpy(&dst_port_net, l4 + 2, sizeof(dst_port_net));
+        const std::uint16_t src_port = ntohs(src_port_net);
+        const std::uint16_t dst_port = ntohs(dst_port_net);
+
+        if (is_sensitive_port(src_port) || is_sensitive_port(dst_port))
+        {
+            return false;
+        }
+
+        if (proto == 17 && (src_port == 53 || dst_port == 53))
+        {
+            return false;
+        }
+
+        if (proto == 6)
+        {
+            if (l4_len < 14U)
+            {
+                return false;
+            }
+            const std::uint8_t tcp_flags = l4[13];
+            if ((tcp_flags & (TH_SYN | TH_RST | TH_FIN)) != 0)
+            {
+                return false;
+            }
+        }
+
+        return !overload.admit(flow_hash(src_addr_net, dst_addr_net, src_port, dst_port, proto));
+    }
 
     // Whitelist of common server ports
     const std::unordered_set<std::uint16_t> SAFE_SERVER_PORTS{
         80, 443, 53, 123, 853, 5353, 4500
     };
 
+    // Helper: UDP flood counter per src->dst pair. Returns the packet count
+    // when the pair crosses the threshold, 0 otherwise. Traffic to or from
+    // whitelisted server ports (QUIC, DNS, NTP, ...) is busy by design and
+    // not counted; DNS has its own checks.
+    int count_udp_flood(std::uint32_t src_addr_net,
+                        std::uint32_t dst_addr_net,
+                        const u_char* l4,
+                        std::size_t   l4_len,
+                        TimePoint     now)
+    {
+        if (l4_len < 4U)
+        {
+            return 0;
+        }
+
+        std::uint16_t src_port_net = 0;
+        std::uint16_t dst_port_net = 0;
+        std::memcpy(&src_port_net, l4 + 0, sizeof(src_port_net));
+        std::memcpy(&dst_port_net, l4 + 2, sizeof(dst_port_net));
+        if (SAFE_SERVER_PORTS.count(ntohs(src_port_net)) != 0U ||
+            SAFE_SERVER_PORTS.count(ntohs(dst_port_net)) != 0U)
+        {
+            return 0;
+        }
+
+        const std::uint64_t key = (std::uint64_t{src_addr_net} << 32) | dst_addr_net;
+        return udp_tracker.with_record(key, now, UDP_FLOOD_WINDOW, [&](auto& rec)
+        {
+            if (rec.packets == 0 || now - rec.first_seen > UDP_FLOOD_WINDOW)
+            {
+                rec.packets    = 0;
+                rec.first_seen = now;
+            }
+
+            if (++rec.packets > UDP_FLOOD_THRESHOLD)
+            {
+                const int count = rec.packets;
+                rec.packets = 0;
+                return count;
+            }
+            return 0;
+        });
+    }
+
+    // Used when the generated filter does not compile (IPv4 only, like the decoder)
+    constexpr const char* FALLBACK_CAPTURE_FILTER = "ip and (tcp or udp or icmp)";
+
+    // Helper: "port a or port b ..." in ascending port order
+    template <typename Ports>
+    std::string bpf_port_list(const Ports& ports)
+    {
+        std::vector<std::uint16_t> sorted(ports.begin(), ports.end());
+        std::sort(sorted.begin(), sorted.end());
+
+        std::string out;
+        for (const std::uint16_t port : sorted)
+        {
+            if (!out.empty()) out += " or ";
+            out += "port " + std::to_string(port);
+        }
+        return out;
+    }
+
+    // Helper: tightest BPF program that still feeds every active rule.
+    //  - ICMP is always needed (ICMP flood).
+    //  - UDP feeds the UDP flood check, which ignores whitelisted ports,
+    //    and the DNS checks on port 53; other whitelisted-port UDP (QUIC,
+    //    NTP, ...) is dropped in the kernel.
+    //  - TCP SYN/RST/FIN drive the scan, RST and reputation rules.
+    //  - SSH/RDP packets always alert.
+    //  - No rule inspects payloads, so data segments of flows on
+    //    whitelisted ports never reach a rule and the kernel drops them.
+    // The decoder is IPv4-only; single 802.1Q tagged frames are matched
+    // through the `vlan` branch like the userspace parser.
+    std::string build_capture_filter()
+    {
+        std::vector<std::uint16_t> quiet_udp_ports;
+        for (const std::uint16_t port : SAFE_SERVER_PORTS)
+        {
+            if (port != 53) quiet_udp_ports.push_back(port);
+        }
+
+        const std::string udp =
+            "(udp and (port 53 or not (" + bpf_port_list(quiet_udp_ports) + ")))";
+
+        const std::string tcp =
+            "(tcp and (tcp[tcpflags] & (tcp-syn|tcp-rst|tcp-fin) != 0 or " +
+            bpf_port_list(SENSITIVE_PORTS) + " or not (" +
+            bpf_port_list(SAFE_SERVER_PORTS) + ")))";
+
+        const std::string l3 = "(ip and (icmp or " + udp + " or " + tcp + "))";
+        return l3 + " or (vlan and " + l3 + ")";
+    }
+
     // // Compat wrappers for thread-safe functions (still needed)
     // static int inet_pton_compat(int af, const char* src, void* dst)
     // {
@@ -143,21 +518,28 @@ namespace
         return out;
     }
 
-    // Helper: Reverse DNS lookup with thread-safe TTL cache (Mutexes removed from logic block)
+    // Helper: Reverse DNS lookup with thread-safe TTL cache (shard lock is
+    // only held for the cache probe/insert, never across getnameinfo)
     static std::string resolve_host_for_ip(const std::string& ip)
     {
         if (ip.empty()) return std::string();
 
-        const auto now = Clock::now();
+        const auto now = PacketClock::now();
 
-        // NO MUTEX HERE: relies on single-threaded nature of pcap_loop
-        auto it = g_dns_cache.find(ip);
-        if (it != g_dns_cache.end())
+        std::string cached;
+        const bool hit = g_dns_cache.with_shard(ip, [&](auto& cache)
         {
-            if (now - it->second.second < DNS_CACHE_TTL)
+            auto it = cache.find(ip);
+            if (it != cache.end() && now - it->second.first_seen < DNS_CACHE_TTL)
             {
-                return it->second.first; // cached name or numeric fallback
+                cached = it->second.host; // cached name or numeric fallback
+                return true;
             }
+            return false;
+        });
+        if (hit)
+        {
+            return cached;
         }
 
         sockaddr_in sa{};
@@ -196,8 +578,11 @@ namespace
             }
         }
 
-        // NO MUTEX HERE: relies on single-threaded nature of pcap_loop
-        g_dns_cache[ip] = std::make_pair(host_res, now);
+        g_dns_cache.with_record(ip, now, DNS_CACHE_TTL, [&](auto& rec)
+        {
+            rec.host       = host_res;
+            rec.first_seen = now;
+        });
 
         return host_res;
     }
@@ -207,8 +592,9 @@ namespace
 
 
 // PacketSniffer Implementation
-PacketSniffer::PacketSniffer(int device_num)
-    : handle_(nullptr)
+PacketSniffer::PacketSniffer(const std::vector<CaptureSource>& sources,
+                             const IpReputationService* reputation)
+    : reputation_(reputation)
 {
     // --- CRITICAL FIX: Initialize Winsock (WSAStartup) ---
     // Required for getnameinfo, InetPton, and other socket API calls on Windows.
@@ -219,24 +605,79 @@ PacketSniffer::PacketSniffer(int device_num)
         }
     }
 
-    if (device_num <= 0)
-        device_num = 1;
+    // Enumerate devices once for all live sources
+    pcap_if_t* alldevs = nullptr;
+    for (const auto& src : sources)
+    {
+        if (src.device_num > 0)
+        {
+            char errbuf[PCAP_ERRBUF_SIZE];
+            std::memset(errbuf, 0, sizeof(errbuf));
+            if (pcap_findalldevs(&alldevs, errbuf) == -1)
+            {
+                std::cerr << "Error finding devices: " << errbuf << "\n";
+                alldevs = nullptr;
+            }
+            else if (!alldevs)
+            {
+                std::cerr << "No devices found.\n";
+            }
+            break;
+        }
+    }
 
-    char errbuf[PCAP_ERRBUF_SIZE];
-    std::memset(errbuf, 0, sizeof(errbuf));
+    for (const auto& src : sources)
+    {
+        if (src.device_num > 0)
+        {
+            if (alldevs) open_live(src.device_num, alldevs);
+        }
+        else
+        {
+            open_offline(src.replay_file);
+        }
+    }
 
-    pcap_if_t* alldevs = nullptr;
-    if (pcap_findalldevs(&alldevs, errbuf) == -1)
+    if (alldevs)
     {
-        std::cerr << "Error finding devices: " << errbuf << "\n";
-        return;
+        pcap_freealldevs(alldevs);
     }
 
-    if (!alldevs)
+    // Open the persistent log stream once and enable immediate flush (unitbuf)
+    log_stream_.open("intrusion_alerts.log", std::ios::app);
+    if (!log_stream_.is_open())
     {
-        std::cerr << "No devices found.\n";
-        return;
+        std::cerr << "Warning: Could not open intrusion_alerts.log for writing.\n";
+    }
+    else
+    {
+        log_stream_.setf(std::ios::unitbuf); // flush after each write
     }
+}
+
+PacketSniffer::~PacketSniffer()
+{
+    for (auto& iface : interfaces_)
+    {
+        if (iface->handle)
+        {
+            pcap_close(iface->handle);
+            iface->handle = nullptr;
+        }
+    }
+    if (log_stream_.is_open())
+    {
+        log_stream_.close();
+    }
+    // --- CRITICAL FIX: Clean up Winsock ---
+    WSACleanup();
+    // ----------------------------------------
+}
+
+bool PacketSniffer::open_live(int device_num, pcap_if_t* alldevs)
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    std::memset(errbuf, 0, sizeof(errbuf));
 
     pcap_if_t* dev = alldevs;
     int        idx = 1;
@@ -256,8 +697,7 @@ PacketSniffer::PacketSniffer(int device_num)
             std::cerr << "   " << i << ": "
                       << (d->description ? d->description : d->name) << "\n";
         }
-        pcap_freealldevs(alldevs);
-        return;
+        return false;
     }
 
     std::cerr << "---\n";
@@ -265,73 +705,226 @@ PacketSniffer::PacketSniffer(int device_num)
               << (dev->description ? dev->description : dev->name) << "\n";
     std::cerr << "---\n";
 
-    handle_ = pcap_open_live(dev->name,
-                             65536,  // snaplen
-                             1,      // promiscuous
-                             1000,   // timeout ms
-                             errbuf);
+    pcap_t* handle = pcap_open_live(dev->name,
+                                    65536,  // snaplen
+                                    1,      // promiscuous
+                                    1000,   // timeout ms
+                                    errbuf);
+    if (!handle)
+    {
+        std::cerr << "Couldn't open device " << dev->name << ": " << errbuf << "\n";
+        return false;
+    }
+
+    auto iface     = std::make_unique<CaptureInterface>();
+    iface->owner   = this;
+    iface->handle  = handle;
+    iface->label   = dev->description ? dev->description : dev->name;
+    apply_filter(*iface);
+    interfaces_.push_back(std::move(iface));
+    return true;
+}
 
-    pcap_freealldevs(alldevs);
+bool PacketSniffer::open_offline(const std::string& path)
+{
+    char errbuf[PCAP_ERRBUF_SIZE];
+    std::memset(errbuf, 0, sizeof(errbuf));
 
-    if (!handle_)
+    pcap_t* handle = pcap_open_offline(path.c_str(), errbuf);
+    if (!handle)
     {
-        std::cerr << "Couldn't open device " << dev->name << ": " << errbuf << "\n";
-        return;
+        std::cerr << "Couldn't open replay file " << path << ": " << errbuf << "\n";
+        return false;
     }
 
-    // Apply a BPF filter to reduce captured traffic (IP + TCP/ICMP only)
+    std::cerr << "Replaying capture file: " << path << "\n";
+
+    auto iface     = std::make_unique<CaptureInterface>();
+    iface->owner   = this;
+    iface->handle  = handle;
+    iface->label   = path;
+    iface->offline = true;
+    apply_filter(*iface);
+    interfaces_.push_back(std::move(iface));
+    return true;
+}
+
+// Compile the capture filter and install it on `iface` before capture starts
+void PacketSniffer::apply_filter(CaptureInterface& iface)
+{
+    const std::string filter = build_capture_filter();
+
+    struct bpf_program fp;
+    const char* installed = filter.c_str();
+    if (pcap_compile(iface.handle, &fp, installed, 1, PCAP_NETMASK_UNKNOWN) != 0)
     {
-        struct bpf_program fp;
-        if (pcap_compile(handle_, &fp, "(ip or ip6) and (tcp or icmp or icmp6)", 1, PCAP_NETMASK_UNKNOWN) == 0)
+        std::cerr << "Warning: could not compile capture filter on " << iface.label
+                  << " (" << pcap_geterr(iface.handle) << "), using fallback\n";
+        installed = FALLBACK_CAPTURE_FILTER;
+        if (pcap_compile(iface.handle, &fp, installed, 1, PCAP_NETMASK_UNKNOWN) != 0)
         {
-            if (pcap_setfilter(handle_, &fp) != 0)
-            {
-                std::cerr << "Warning: pcap_setfilter failed\n";
-            }
-            pcap_freecode(&fp);
+            std::cerr << "Warning: could not compile fallback filter on " << iface.label
+                      << " (" << pcap_geterr(iface.handle) << "), capturing unfiltered\n";
+            return;
         }
     }
 
-    // Open the persistent log stream once and enable immediate flush (unitbuf)
-    log_stream_.open("intrusion_alerts.log", std::ios::app);
-    if (!log_stream_.is_open())
+    if (pcap_setfilter(iface.handle, &fp) != 0)
     {
-        std::cerr << "Warning: Could not open intrusion_alerts.log for writing.\n";
+        std::cerr << "Warning: pcap_setfilter failed on " << iface.label << "\n";
     }
     else
     {
-        log_stream_.setf(std::ios::unitbuf); // flush after each write
+        std::cerr << "[" << iface.label << "] capture filter: " << installed << "\n";
     }
+    pcap_freecode(&fp);
 }
 
-PacketSniffer::~PacketSniffer()
+void PacketSniffer::start_sniffing()
 {
-    if (handle_)
+    if (interfaces_.empty())
     {
-        pcap_close(handle_);
-        handle_ = nullptr;
+        std::cerr << "No capture interface opened. Cannot start sniffing.\n";
+        return;
     }
-    if (log_stream_.is_open())
+
+    // One capture thread per interface, all feeding the shared detection state
+    std::vector<std::thread> threads;
+    threads.reserve(interfaces_.size());
+    for (auto& iface : interfaces_)
     {
-        log_stream_.close();
+        threads.emplace_back(&PacketSniffer::capture_loop, this, std::ref(*iface));
+    }
+    for (auto& t : threads)
+    {
+        t.join();
     }
-    // --- CRITICAL FIX: Clean up Winsock ---
-    WSACleanup();
-    // ----------------------------------------
 }
 
-void PacketSniffer::start_sniffing()
+void PacketSniffer::stop()
 {
-    if (!handle_)
+    stop_requested_ = true;
+    for (auto& iface : interfaces_)
     {
-        std::cerr << "pcap handle is null. Cannot start sniffing.\n";
-        return;
+        if (iface->handle)
+        {
+            pcap_breakloop(iface->handle);
+        }
+    }
+}
+
+void PacketSniffer::capture_loop(CaptureInterface& iface)
+{
+    auto next_stats    = Clock::now() + STATS_INTERVAL;
+    auto next_overload = Clock::now() + OverloadController::EVAL_INTERVAL;
+    iface.idle_since   = Clock::now();
+
+    // pcap_dispatch returns after each buffer (or read timeout), which lets
+    // this loop notice stop requests and report stats between batches
+    while (!stop_requested_)
+    {
+        // Pick up a reloaded reputation table (one atomic load per batch)
+        if (reputation_)
+        {
+            iface.reputation = reputation_->snapshot();
+        }
+
+        iface.dispatch_start = Clock::now();
+        iface.batch_started  = false;
+
+        const int n = pcap_dispatch(iface.handle,
+                                    -1,
+                                    &PacketSniffer::packet_handler_callback,
+                                    reinterpret_cast<u_char*>(&iface));
+        if (n == PCAP_ERROR_BREAK)
+        {
+            break;
+        }
+        if (n < 0)
+        {
+            std::cerr << "[" << iface.label << "] capture error: " << pcap_geterr(iface.handle) << "\n";
+            break;
+        }
+        if (n == 0 && iface.offline)
+        {
+            break; // end of replay file
+        }
+
+        const auto now = Clock::now();
+
+        if (!iface.batch_started)
+        {
+            iface.idle += now - iface.dispatch_start;
+        }
+
+        // Replay files are read as fast as we process them, nothing to shed
+        if (!iface.offline && now >= next_overload)
+        {
+            update_overload(iface, now);
+            next_overload = now + OverloadController::EVAL_INTERVAL;
+        }
+
+        if (now >= next_stats)
+        {
+            log_interface_stats(iface);
+            next_stats = now + STATS_INTERVAL;
+        }
+    }
+
+    log_interface_stats(iface);
+}
+
+void PacketSniffer::update_overload(CaptureInterface& iface, Clock::time_point now)
+{
+    std::uint64_t drops = 0;
+    pcap_stat ps{};
+    if (pcap_stats(iface.handle, &ps) == 0)
+    {
+        drops = ps.ps_drop;
+    }
+
+    const auto idle    = iface.idle;
+    const auto elapsed = now - iface.idle_since;
+    iface.idle       = Clock::duration{0};
+    iface.idle_since = now;
+
+    if (iface.overload.update(drops, idle, elapsed))
+    {
+        std::ostringstream ss;
+        ss << "[" << iface.label << "] overload: sampling data packets at "
+           << std::fixed << std::setprecision(1) << iface.overload.sample_rate() * 100.0
+           << "% (kernel_drop=" << drops << ", idle="
+           << std::chrono::duration_cast<std::chrono::milliseconds>(idle).count() << "ms of "
+           << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() << "ms)\n";
+        std::cerr << ss.str();
+    }
+}
+
+void PacketSniffer::log_interface_stats(CaptureInterface& iface)
+{
+    std::ostringstream ss;
+    ss << "[" << iface.label << "] packets=" << iface.packets.load(std::memory_order_relaxed)
+       << " bytes="  << iface.bytes.load(std::memory_order_relaxed)
+       << " alerts=" << iface.alerts.load(std::memory_order_relaxed)
+       << " shed="   << iface.shed.load(std::memory_order_relaxed)
+       << " forwarded=" << iface.forwarded.load(std::memory_order_relaxed)
+       << " sample_rate=" << iface.overload.sample_rate();
+
+    const std::uint64_t dns = iface.dns_messages.load(std::memory_order_relaxed);
+    if (dns > 0)
+    {
+        ss << " dns=" << dns
+           << " dns_parse_ns_avg=" << iface.dns_parse_ns.load(std::memory_order_relaxed) / dns;
     }
 
-    pcap_loop(handle_,
-              -1, // infinite loop
-              &PacketSniffer::packet_handler_callback,
-              reinterpret_cast<u_char*>(this));
+    pcap_stat ps{};
+    if (!iface.offline && pcap_stats(iface.handle, &ps) == 0)
+    {
+        ss << " kernel_recv=" << ps.ps_recv << " kernel_drop=" << ps.ps_drop;
+    }
+    ss << "\n";
+
+    std::cerr << ss.str();
 }
 
 // static callback required by libpcap
@@ -340,14 +933,26 @@ void PacketSniffer::packet_handler_callback(
     const pcap_pkthdr* pkthdr,
     const u_char* packet_data)
 {
-    auto* sniffer = reinterpret_cast<PacketSniffer*>(user_data);
-    if (!sniffer || !pkthdr || !packet_data)
+    auto* iface = reinterpret_cast<CaptureInterface*>(user_data);
+    if (!iface || !iface->owner || !pkthdr || !packet_data)
     {
         return;
     }
 
-    // FIX: Call site now uses the correct 2-argument signature for the instance method
-    sniffer->process_packet_with_len(packet_data, pkthdr->len);
+    iface->packets.fetch_add(1, std::memory_order_relaxed);
+    iface->bytes.fetch_add(pkthdr->len, std::memory_order_relaxed);
+
+    // First packet of this dispatch: the wait for the driver ends here
+    if (!iface->batch_started)
+    {
+        iface->batch_started = true;
+        iface->idle += Clock::now() - iface->dispatch_start;
+    }
+
+    const TimePoint ts(std::chrono::seconds(pkthdr->ts.tv_sec) + std::chrono::microseconds(pkthdr->ts.tv_usec));
+
+    // Parse only the captured bytes (caplen); replay files may be truncated by their snaplen
+    iface->owner->process_packet_with_len(*iface, packet_data, pkthdr->caplen, ts);
 }
 
 // Legacy compatibility (no-op)
@@ -357,9 +962,10 @@ void PacketSniffer::process_packet(const u_char* /*packet_data*/)
 }
 
 // Length-aware processing (safe parsing)
-// FIX: Function definition is simplified back to 2 arguments to match the call above
-void PacketSniffer::process_packet_with_len(const u_char* packet_data,
-                                            bpf_u_int32   packet_len)
+void PacketSniffer::process_packet_with_len(CaptureInterface& iface,
+                                            const u_char*     packet_data,
+                                            bpf_u_int32       packet_len,
+                                            std::chrono::system_clock::time_point now)
 {
     if (!packet_data || packet_len < 14U)
     {
@@ -427,6 +1033,53 @@ void PacketSniffer::process_packet_with_len(const u_char* packet_data,
     std::memcpy(&src_addr_net, ip_ptr + 12, sizeof(src_addr_net));
     std::memcpy(&dst_addr_net, ip_ptr + 16, sizeof(dst_addr_net));
 
+    // Routed between two monitored interfaces: count the first copy only,
+    // before shedding so every tracker sees the deduplicated stream
+    if (interfaces_.size() > 1 &&
+        is_forwarded_copy(&iface,
+                          forwarded_packet_key(ip_ptr, ip_header_len, packet_len - eth_hdr_len),
+                          now))
+    {
+        iface.forwarded.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // A UDP flood is the likeliest cause of overload, so its counter (one
+    // shard lookup, no allocation) sees every packet, shed or not; a
+    // packet that trips the threshold is never shed
+    const int udp_flood_packets =
+        proto == 17 ? count_udp_flood(src_addr_net, dst_addr_net, ip_ptr + ip_header_len,
+                                      packet_len - eth_hdr_len - ip_header_len, now)
+                    : 0;
+
+    // Load shedding runs before any lookup or string formatting
+    if (iface.overload.shedding() && udp_flood_packets == 0 &&
+        may_shed(iface.overload, proto, src_addr_net, dst_addr_net,
+                 ip_ptr + ip_header_len, packet_len - eth_hdr_len - ip_header_len))
+    {
+        iface.shed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+
+    // Reputation tagging: a few node reads per address on the thread's snapshot
+    IpReputation src_rep = IpReputation::Unknown;
+    IpReputation dst_rep = IpReputation::Unknown;
+    if (const IpReputationTable* table = iface.reputation.get())
+    {
+        src_rep = table->lookup_v4(src_addr_net);
+        dst_rep = table->lookup_v4(dst_addr_net);
+    }
+
+    const bool blocklisted = src_rep == IpReputation::Block || dst_rep == IpReputation::Block;
+
+    // Traffic sent by an allowlisted host is trusted. An allowlisted
+    // destination alone is not enough: probes from unknown hosts against
+    // allowlisted servers must still be detected.
+    if (!blocklisted && src_rep == IpReputation::Allow)
+    {
+        return;
+    }
+
     const std::string src_ip = ip_to_string(src_addr_net);
     const std::string dst_ip = ip_to_string(dst_addr_net);
 
@@ -446,7 +1099,7 @@ void PacketSniffer::process_packet_with_len(const u_char* packet_data,
 
     // Helper: Emit alert as JSON, explicitly capturing 'this'
     auto emit_alert_json =
-    [this, src_ip, dst_ip](const std::string& proto_name,
+    [this, &iface, src_ip, dst_ip](const std::string& proto_name,
         const std::string& severity,
         const std::string& description,
         const std::string& host)
@@ -458,7 +1111,14 @@ void PacketSniffer::process_packet_with_len(const u_char* packet_data,
            << "\"dst_ip\":\""  << json_escape(dst_ip) << "\","
            << "\"proto\":\""   << json_escape(proto_name) << "\","
            << "\"severity\":\""<< json_escape(severity) << "\","
-           << "\"desc\":\""    << json_escape(description) << "\"";
+           << "\"desc\":\""    << json_escape(description) << "\","
+           << "\"iface\":\""   << json_escape(iface.label) << "\"";
+
+        // Lets downstream scale counts derived from sampled traffic
+        if (iface.overload.shedding())
+        {
+            ss << ",\"sample_rate\":" << iface.overload.sample_rate();
+        }
 
         if (!host.empty())
         {
@@ -468,6 +1128,11 @@ void PacketSniffer::process_packet_with_len(const u_char* packet_data,
 
         const std::string json = ss.str();
 
+        iface.alerts.fetch_add(1, std::memory_order_relaxed);
+
+        // Capture threads share stdout and the log file; keep each line intact
+        std::lock_guard<std::mutex> lock(this->output_mutex_);
+
         std::cout << json;
         std::cout.flush();
 
@@ -478,24 +1143,60 @@ void PacketSniffer::process_packet_with_len(const u_char* packet_data,
         }
     };
 
-    // ICMP handling (protocol 1)
-    if (proto == 1)
+    // Known-bad host check (rate-limited per address, other rules still run)
+    if (blocklisted)
     {
-        static std::unordered_map<std::string, int> icmp_count;
-        static TimePoint last_cleanup = Clock::now();
+        const bool          src_bad = src_rep == IpReputation::Block;
+        const std::uint32_t bad_ip  = src_bad ? src_addr_net : dst_addr_net;
 
-        const auto now = Clock::now();
+        const bool due = g_reputation_alerts.with_record(bad_ip, now, REPUTATION_ALERT_COOLDOWN, [&](auto& rec)
+        {
+            if (rec.first_seen != TimePoint{} && now - rec.first_seen < REPUTATION_ALERT_COOLDOWN)
+            {
+                return false;
+            }
+            rec.first_seen = now;
+            return true;
+        });
 
-        if (std::chrono::duration_cast<std::chrono::seconds>(now - last_cleanup).count() > 5)
+        if (due)
         {
-            icmp_count.clear();
-            last_cleanup = now;
+            const char* proto_name = proto == 1 ? "ICMP" : proto == 6 ? "TCP" : proto == 17 ? "UDP" : "IP";
+            const std::string& bad_str = src_bad ? src_ip : dst_ip;
+            emit_alert_json(
+                proto_name,
+                "high",
+                std::string(src_bad ? "Traffic from" : "Traffic to") +
+                " blocklisted host " + bad_str,
+                resolve_host_for_ip(bad_str));
         }
+    }
+
+    // ICMP handling (protocol 1)
+    if (proto == 1)
+    {
+        constexpr auto ICMP_WINDOW    = std::chrono::seconds(5);
+        constexpr int  ICMP_THRESHOLD = 3;
 
         const std::string key = src_ip + "->" + dst_ip;
-        ++icmp_count[key];
 
-        if (icmp_count[key] > 3)
+        const bool flood = icmp_tracker.with_record(key, now, ICMP_WINDOW, [&](auto& rec)
+        {
+            if (rec.count == 0 || now - rec.first_seen > ICMP_WINDOW)
+            {
+                rec.count      = 0;
+                rec.first_seen = now;
+            }
+
+            if (++rec.count > ICMP_THRESHOLD)
+            {
+                rec.count = 0;
+                return true;
+            }
+            return false;
+        });
+
+        if (flood)
         {
             std::string host = resolve_host_for_ip(pick_remote_ip());
             emit_alert_json(
@@ -503,7 +1204,6 @@ void PacketSniffer::process_packet_with_len(const u_char* packet_data,
                 "medium",
                 "High ICMP traffic detected (possible ping flood) from " + src_ip,
                 host);
-            icmp_count[key] = 0;
         }
         return;
     }
@@ -511,6 +1211,166 @@ void PacketSniffer::process_packet_with_len(const u_char* packet_data,
     // UDP handling (protocol 17)
     if (proto == 17)
     {
+        const std::size_t udp_off = eth_hdr_len + ip_header_len;
+
+        if (packet_len < udp_off + 8U)
+        {
+            return;
+        }
+
+        std::uint16_t src_port_net = 0;
+        std::uint16_t dst_port_net = 0;
+        std::uint16_t udp_len_net  = 0;
+
+        std::memcpy(&src_port_net, packet_data + udp_off + 0, sizeof(src_port_net));
+        std::memcpy(&dst_port_net, packet_data + udp_off + 2, sizeof(dst_port_net));
+        std::memcpy(&udp_len_net,  packet_data + udp_off + 4, sizeof(udp_len_net));
+
+        const std::uint16_t src_port = ntohs(src_port_net);
+        const std::uint16_t dst_port = ntohs(dst_port_net);
+        const std::size_t   udp_len  = ntohs(udp_len_net);
+
+        // The UDP length must fit in the IP datagram; a forged length would
+        // otherwise inflate the DNS amplification byte counts
+        std::uint16_t ip_total_len_net = 0;
+        std::memcpy(&ip_total_len_net, ip_ptr + 2, sizeof(ip_total_len_net));
+        const std::size_t ip_total_len = ntohs(ip_total_len_net);
+
+        if (udp_len < 8U || ip_total_len < ip_header_len || udp_len > ip_total_len - ip_header_len)
+        {
+            return;
+        }
+
+        // Payload ends at the UDP length or the captured bytes, whichever is shorter
+        const u_char*     payload     = packet_data + udp_off + 8U;
+        const std::size_t payload_len = std::min(udp_len - 8U, packet_len - udp_off - 8U);
+
+        // --- UDP flood alert (counted before load shedding) ---
+        if (udp_flood_packets > 0)
+        {
+            emit_alert_json(
+                "UDP",
+                "high",
+                "UDP flood detected from " + src_ip + " to " + dst_ip +
+                " (" + std::to_string(udp_flood_packets) + " packets)",
+                resolve_host_for_ip(pick_remote_ip()));
+        }
+
+        if (src_port != 53 && dst_port != 53)
+        {
+            return;
+        }
+
+        // --- DNS analysis (parsed in place, no allocation) ---
+        DnsMessage dns;
+        const auto parse_start = Clock::now();
+        const bool parsed      = dns.parse(payload, payload_len);
+        iface.dns_parse_ns.fetch_add(
+            static_cast<std::uint64_t>(
+                std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - parse_start).count()),
+            std::memory_order_relaxed);
+        iface.dns_messages.fetch_add(1, std::memory_order_relaxed);
+
+        if (!parsed)
+        {
+            return;
+        }
+
+        // Amplification: bytes answered to a client vs bytes it asked for
+        {
+            const bool          response = dns.is_response() && src_port == 53;
+            const std::uint32_t client   = response ? dst_addr_net : src_addr_net;
+
+            const std::uint64_t amplified = dns_volume_tracker.with_record(client, now, DNS_WINDOW, [&](auto& rec)
+            {
+                if (now - rec.first_seen > DNS_WINDOW)
+                {
+                    rec = DNSVolumeRecord{};
+                    rec.first_seen = now;
+                }
+
+                // Wire size from the UDP header: the capture may be cut at snaplen
+                if (response)
+                    rec.response_bytes += udp_len - 8U;
+                else
+                    rec.request_bytes += udp_len - 8U;
+
+                if (rec.response_bytes >= DNS_AMP_MIN_BYTES &&
+                    rec.response_bytes > DNS_AMP_MIN_RATIO * rec.request_bytes)
+                {
+                    const std::uint64_t bytes = rec.response_bytes;
+                    rec = DNSVolumeRecord{};
+                    rec.first_seen = now;
+                    return bytes;
+                }
+                return std::uint64_t{0};
+            });
+
+            if (amplified > 0)
+            {
+                const std::string victim = response ? dst_ip : src_ip;
+                emit_alert_json(
+                    "DNS",
+                    "high",
+                    "Possible DNS amplification toward " + victim + " (" +
+                    std::to_string(amplified / 1024) + " KiB of responses, few or no queries)",
+                    resolve_host_for_ip(pick_remote_ip()));
+            }
+        }
+
+        // Tunneling: sustained query rate from one client to one base domain
+        // with long, high-entropy subdomains. Pooling clients would let busy
+        // hashed-label lookups (AV reputation DNS) be blamed on whichever
+        // host sent the threshold query.
+        if (!dns.is_response())
+        {
+            const DnsMessage::NameStats& name = dns.qname_stats();
+            const std::uint64_t          key  = fmix64(name.base_hash ^ src_addr_net);
+
+            int   queries     = 0;
+            float avg_sub_len = 0;
+            float avg_entropy = 0;
+
+            dns_domain_tracker.with_record(key, now, DNS_WINDOW, [&](auto& rec)
+            {
+                if (rec.queries == 0 || now - rec.first_seen > DNS_WINDOW)
+                {
+                    rec = DNSDomainRecord{};
+                    rec.first_seen = now;
+                }
+
+                ++rec.queries;
+                rec.sub_len_sum += name.sub_len;
+                rec.entropy_sum += name.sub_entropy;
+
+                if (rec.queries >= DNS_TUNNEL_MIN_QUERIES)
+                {
+                    const float sub_len = static_cast<float>(rec.sub_len_sum) / rec.queries;
+                    const float entropy = rec.entropy_sum / rec.queries;
+                    if (sub_len >= DNS_TUNNEL_MIN_SUB_LEN && entropy >= DNS_TUNNEL_MIN_ENTROPY)
+                    {
+                        queries     = rec.queries;
+                        avg_sub_len = sub_len;
+                        avg_entropy = entropy;
+                        rec = DNSDomainRecord{};
+                    }
+                }
+            });
+
+            if (queries > 0)
+            {
+                std::ostringstream desc;
+                desc << "Possible DNS tunneling via " << dns.base_domain() << " from " << src_ip
+                     << " (" << queries << " queries/" << DNS_WINDOW.count() << "s, avg subdomain "
+                     << std::fixed << std::setprecision(1) << avg_sub_len << " chars, entropy "
+                     << std::setprecision(2) << avg_entropy << " bits/char)";
+                emit_alert_json(
+                    "DNS",
+                    "high",
+                    desc.str(),
+                    resolve_host_for_ip(pick_remote_ip()));
+            }
+        }
         return;
     }
 
@@ -554,43 +1414,49 @@ void PacketSniffer::process_packet_with_len(const u_char* packet_data,
         // --- SYN scan check runs FIRST (LOGIC FIX) ---
         if (is_syn && !is_ack && !is_rst && !is_fin && !is_psh)
         {
-            const std::string key = src_ip + "->" + dst_ip;
-            auto&             rec = scan_tracker[key];
+            constexpr auto SYN_WINDOW    = std::chrono::milliseconds(5000);
+            constexpr int  SYN_THRESHOLD = 10;
 
-            const auto now = Clock::now();
+            const std::string key = src_ip + "->" + dst_ip;
 
-            if (rec.syns == 0)
+            // Shared across interfaces: probes seen on WAN and DMZ add up
+            const int probes = scan_tracker.with_record(key, now, SYN_WINDOW, [&](auto& rec)
             {
-                rec.syns       = 1;
-                rec.first_seen = now;
-            }
-            else
-            {
-                const auto elapsed_ms =
-                    std::chrono::duration_cast<std::chrono::milliseconds>(now - rec.first_seen)
-                        .count();
-
-                if (elapsed_ms <= 5000)
+                if (rec.syns == 0)
                 {
-                    ++rec.syns;
+                    rec.syns       = 1;
+                    rec.first_seen = now;
                 }
                 else
                 {
-                    rec.syns       = 1;
-                    rec.first_seen = now;
+                    if (now - rec.first_seen <= SYN_WINDOW)
+                    {
+                        ++rec.syns;
+                    }
+                    else
+                    {
+                        rec.syns       = 1;
+                        rec.first_seen = now;
+                    }
                 }
-            }
 
-            constexpr int SYN_THRESHOLD = 10;
-            if (rec.syns > SYN_THRESHOLD)
+                if (rec.syns > SYN_THRESHOLD)
+                {
+                    const int count = rec.syns;
+                    rec.syns = 0;
+                    return count;
+                }
+                return 0;
+            });
+
+            if (probes > 0)
             {
                 emit_alert_json(
                     "TCP",
                     "critical",
                     "TCP SYN flood/scan detected from " + src_ip +
-                    " to " + dst_ip + " (" + std::to_string(rec.syns) + " probes)",
+                    " to " + dst_ip + " (" + std::to_string(probes) + " probes)",
                     host);
-                rec.syns = 0;
             }
             return;
         }
@@ -5,12 +5,33 @@
 #include <ws2tcpip.h>
 #include <pcap.h>
 
-#include <fstream> 
+#include "overload_controller.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <memory>
+#include <mutex>
 #include <string>
+#include <vector>
+
+class IpReputationService;
+class IpReputationTable;
+
+// One capture input: a live device (1-based index) or a pcap replay file
+struct CaptureSource
+{
+    int         device_num = 0;   // > 0 selects a live device
+    std::string replay_file;      // used when device_num == 0
+};
 
 class PacketSniffer {
 public:
-    explicit PacketSniffer(int device_num);
+    // Opens every source; sources that fail to open are reported and skipped.
+    // `reputation` is optional and must outlive the sniffer
+    explicit PacketSniffer(const std::vector<CaptureSource>& sources,
+                           const IpReputationService* reputation = nullptr);
     ~PacketSniffer();
 
     // Non-copyable
@@ -21,15 +42,65 @@ public:
     PacketSniffer(PacketSniffer&&) = delete;
     PacketSniffer& operator=(PacketSniffer&&) = delete;
 
-    // Start packet capture loop (blocking)
+    // Start one capture thread per interface and wait for all of them (blocking)
     void start_sniffing();
 
+    // Break every capture loop; safe to call from a signal handler thread
+    void stop();
+
 private:
-    pcap_t* handle_;           // libpcap capture handle
+    // Per-interface capture state. Counters are only written by the
+    // interface's own capture thread and read by the stats reporter.
+    struct CaptureInterface
+    {
+        PacketSniffer*             owner   = nullptr;
+        pcap_t*                    handle  = nullptr;  // libpcap capture handle
+        std::string                label;              // interface tag on alerts
+        bool                       offline = false;    // replay file, no kernel stats
+
+        std::atomic<std::uint64_t> packets{0};
+        std::atomic<std::uint64_t> bytes{0};
+        std::atomic<std::uint64_t> alerts{0};
+        std::atomic<std::uint64_t> shed{0};      // data packets skipped by load shedding
+        std::atomic<std::uint64_t> forwarded{0}; // routed copies already seen on another interface
+        std::atomic<std::uint64_t> dns_messages{0};
+        std::atomic<std::uint64_t> dns_parse_ns{0};  // total time spent in DnsMessage::parse
+
+        OverloadController overload;
+
+        // Time blocked waiting for the driver: from entering pcap_dispatch to
+        // its first callback, or to its return when nothing arrived
+        std::chrono::steady_clock::time_point dispatch_start;
+        bool                                  batch_started = false;  // first callback of this dispatch seen
+        std::chrono::steady_clock::duration   idle{0};               // accumulated since idle_since
+        std::chrono::steady_clock::time_point idle_since;            // last overload update
+
+        // Reputation snapshot used by this capture thread, refreshed between
+        // batches so packets never touch the shared pointer
+        std::shared_ptr<const IpReputationTable> reputation;
+    };
+
+    std::vector<std::unique_ptr<CaptureInterface>> interfaces_;
+
+    // CIDR allow/block list lookups (may be null)
+    const IpReputationService* reputation_;
+
+    std::atomic<bool> stop_requested_{false};
 
     // Persistent log stream for performance fix
     std::ofstream log_stream_;
 
+    // Serializes alert lines on stdout / log_stream_ across capture threads
+    std::mutex output_mutex_;
+
+    bool open_live(int device_num, pcap_if_t* alldevs);
+    bool open_offline(const std::string& path);
+    void apply_filter(CaptureInterface& iface);
+
+    void capture_loop(CaptureInterface& iface);
+    void log_interface_stats(CaptureInterface& iface);
+    void update_overload(CaptureInterface& iface, std::chrono::steady_clock::time_point now);
+
     static void packet_handler_callback(
         u_char* user_data,
         const pcap_pkthdr* pkthdr,
@@ -38,7 +109,10 @@ private:
     void process_packet(const u_char* packet_data);
 
     // <-- SIGNATURE FIX: member function taking packet pointer + length
-    void process_packet_with_len(const u_char* packet_data, bpf_u_int32 packet_len);
+    void process_packet_with_len(CaptureInterface& iface,
+                                 const u_char*     packet_data,
+                                 bpf_u_int32       packet_len,
+                                 std::chrono::system_clock::time_point now);  // capture timestamp
 };
 
 #endif  // PACKET_SNIFFER_H